@@ -7,12 +7,55 @@
 #include <time.h>
 #include <unistd.h>
 
+#include "fibuser.h"
+
 #define FIB_DEV "/dev/fibonacci"
 
-int main()
+/* Requests go to FIB_DEV, or to the userspace engine built from the same
+ * arithmetic when the module is not loaded or -u is given. Output is the
+ * same either way, so the timings compare syscalls with in-process calls.
+ * -k insists on FIB_DEV, for runs that check the module itself.
+ */
+static int fd = -1;
+static struct fib_engine *engine;
+static unsigned int engine_offset;
+
+static long long fib_write(const char *buf, size_t size)
+{
+    /* write operation is skipped by the module too */
+    return engine ? 1 : write(fd, buf, size);
+}
+
+static void fib_seek(int offset)
+{
+    if (engine)
+        engine_offset = offset;
+    else
+        lseek(fd, offset, SEEK_SET);
+}
+
+static long long fib_read(char *buf, size_t size)
+{
+    if (!engine)
+        return read(fd, buf, size);
+    enum fib_algo algo =
+        memcmp(buf, "fast", 4) ? FIB_ALGO_REGULAR : FIB_ALGO_FAST;
+    return fib_engine_read(engine, engine_offset, algo, buf);
+}
+
+static long long elapsed_ns(const struct timespec *t1,
+                            const struct timespec *t2)
+{
+    return (t2->tv_sec - t1->tv_sec) * 1000000000LL +
+           (t2->tv_nsec - t1->tv_nsec);
+}
+
+int main(int argc, char **argv)
 {
-    int fd;
     long long sz;
+    int userspace = 0, kernel = 0;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int opt;
 
     char buf[16] = {0};
     char write_buf[] = "testing writing";
@@ -21,47 +64,79 @@ int main()
 
     struct timespec t1, t2;
 
-    fd = open(FIB_DEV, O_RDWR);
+    while ((opt = getopt(argc, argv, "kut:")) != -1) {
+        switch (opt) {
+        case 'k':
+            kernel = 1;
+            break;
+        case 'u':
+            userspace = 1;
+            break;
+        case 't':
+            threads = atol(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-k | -u] [-t threads]\n", argv[0]);
+            exit(1);
+        }
+    }
 
-    if (fd < 0) {
-        perror("Failed to open character device");
+    if (kernel && userspace) {
+        fprintf(stderr, "-k and -u cannot be used together\n");
         exit(1);
     }
+    if (!userspace) {
+        fd = open(FIB_DEV, O_RDWR);
+        if (fd < 0) {
+            perror("Failed to open character device");
+            if (kernel)
+                exit(1);
+            fprintf(stderr, "Falling back to the userspace engine\n");
+        }
+    }
+    if (fd < 0) {
+        engine = fib_engine_create(threads > 0 ? threads : 0, NULL);
+        if (engine == NULL) {
+            perror("Failed to start the userspace engine");
+            exit(1);
+        }
+    }
 
     for (i = 0; i <= offset; i++) {
-        sz = write(fd, write_buf, strlen(write_buf));
+        sz = fib_write(write_buf, strlen(write_buf));
         printf("Writing to " FIB_DEV ", returned the sequence %lld\n", sz);
     }
 
     for (i = 0; i <= offset; i++) {
-        lseek(fd, i, SEEK_SET);
+        fib_seek(i);
         memset(buf, 0, 16);
         memcpy(buf, "fast", 4);
-        clock_gettime(CLOCK_REALTIME, &t1);
-        sz = read(fd, buf, 16);
-        clock_gettime(CLOCK_REALTIME, &t2);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        sz = fib_read(buf, 16);
+        clock_gettime(CLOCK_MONOTONIC, &t2);
         printf("(fast)Reading from " FIB_DEV
                " at offset %d, returned the sequence "
                "%llu + (%d * 18446744073709551616).\n",
                i, sz, buf[8]);
-        printf("Time: %ld %ld\n", (t1.tv_sec - t2.tv_sec),
-               (t1.tv_nsec - t2.tv_nsec));
+        printf("Time: %lld\n", elapsed_ns(&t1, &t2));
 
     }
 
     for (i = offset; i >= 0; i--) {
-        lseek(fd, i, SEEK_SET);
-        clock_gettime(CLOCK_REALTIME, &t1);
-        sz = read(fd, buf, 16);
-        clock_gettime(CLOCK_REALTIME, &t2);
+        fib_seek(i);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        sz = fib_read(buf, 16);
+        clock_gettime(CLOCK_MONOTONIC, &t2);
         printf("(Regular)Reading from " FIB_DEV
                " at offset %d, returned the sequence "
                "%llu + (%d * 18446744073709551616).\n",
                i, sz, buf[8]);
-        printf("Time: %ld %ld\n", (t1.tv_sec - t2.tv_sec),
-               (t1.tv_nsec - t2.tv_nsec));
+        printf("Time: %lld\n", elapsed_ns(&t1, &t2));
     }
 
-    close(fd);
+    if (engine)
+        fib_engine_destroy(engine);
+    else
+        close(fd);
     return 0;
 }
@@ -0,0 +1,232 @@
+#ifndef FIB_ARITH_H
+#define FIB_ARITH_H
+
+/* Fixed width arithmetic shared by fibdrv.c and the userspace tests.
+ *
+ * A number is two unsigned long long limbs, [0] is the low limb and [1]
+ * the high one, so every operation here is carried out modulo 2^128.
+ * f(186) is the largest fibonacci number that fits, beyond it the result
+ * is f(k) mod 2^128.
+ */
+
+#ifdef __KERNEL__
+#include <linux/kernel.h>
+#include <linux/slab.h>
+
+#define fib_malloc(size) kmalloc(size, GFP_KERNEL)
+#define fib_free(ptr) kfree(ptr)
+#define fib_log(...) printk(__VA_ARGS__)
+#else
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define fib_malloc(size) malloc(size)
+#define fib_free(ptr) free(ptr)
+#define fib_log(...) printf(__VA_ARGS__)
+#endif
+
+#define FIB_LIMBS 2
+#define FIB_LIMB_BITS (8 * sizeof(unsigned long long))
+
+/* The loops below poll fib_preempt(req) and give up, returning NULL, once
+ * it is nonzero. req is opaque here; fibdrv.c defines both to reschedule
+ * and to enforce the budget of a read, userspace never stops.
+ */
+struct fib_req;
+#ifndef fib_preempt
+#define fib_preempt(req) ((void) (req), 0)
+#endif
+#define FIB_PREEMPT_STEPS 1024
+
+static inline unsigned long long *fib_alloc(void)
+{
+    unsigned long long *r =
+        fib_malloc(FIB_LIMBS * sizeof(unsigned long long));
+    if (r == NULL)
+        fib_log("kmalloc error");
+    return r;
+}
+
+/* r = a + b, r may alias a or b */
+static inline void fib_add(unsigned long long *r,
+                           const unsigned long long *a,
+                           const unsigned long long *b)
+{
+    unsigned long long lo = a[0] + b[0];
+    r[1] = a[1] + b[1] + (lo < a[0]);
+    r[0] = lo;
+}
+
+/* r = a - b, r may alias a or b */
+static inline void fib_sub(unsigned long long *r,
+                           const unsigned long long *a,
+                           const unsigned long long *b)
+{
+    unsigned long long lo = a[0] - b[0];
+    r[1] = a[1] - b[1] - (a[0] < b[0]);
+    r[0] = lo;
+}
+
+/* r = x * y, the full 128-bit product of two limbs */
+static inline void fib_mul64(unsigned long long *r,
+                             unsigned long long x,
+                             unsigned long long y)
+{
+    unsigned long long xl = x & 0xFFFFFFFF, xh = x >> 32;
+    unsigned long long yl = y & 0xFFFFFFFF, yh = y >> 32;
+    unsigned long long ll = xl * yl, lh = xl * yh;
+    unsigned long long hl = xh * yl, hh = xh * yh;
+    unsigned long long mid =
+        (ll >> 32) + (lh & 0xFFFFFFFF) + (hl & 0xFFFFFFFF);
+    r[0] = (mid << 32) | (ll & 0xFFFFFFFF);
+    r[1] = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+}
+
+/* r = a * b, r may alias a or b */
+static inline void fib_mul(unsigned long long *r,
+                           const unsigned long long *a,
+                           const unsigned long long *b)
+{
+    /* a[1] * b[1] is shifted out of the 128 bits entirely */
+    unsigned long long cross = a[0] * b[1] + a[1] * b[0];
+    fib_mul64(r, a[0], b[0]);
+    r[1] += cross;
+}
+
+/* r = a * a, r may alias a */
+static inline void fib_sqr(unsigned long long *r, const unsigned long long *a)
+{
+    unsigned long long cross = (a[0] * a[1]) << 1;
+    fib_mul64(r, a[0], a[0]);
+    r[1] += cross;
+}
+
+static inline unsigned long long *subtractor(unsigned long long *k1,
+                                             unsigned long long *k2)
+{
+    /* Assume k1 >= k2, return positive, or NULL as fail */
+    if (k1 == NULL || k2 == NULL)
+        return NULL;
+    if (k1[1] < k2[1])
+        return NULL;
+    if ((k1[1] == k2[1]) && (k1[0] < k2[0]))
+        return NULL;
+    unsigned long long *r = fib_alloc();
+    if (r == NULL)
+        return NULL;
+    fib_sub(r, k1, k2);
+    return r;
+}
+
+static inline unsigned long long *adder(unsigned long long *k1,
+                                        unsigned long long *k2)
+{
+    unsigned long long *r = fib_alloc();
+    if (r == NULL)
+        return NULL;
+    fib_add(r, k1, k2);
+    return r;
+}
+
+static inline unsigned long long *multiplier(unsigned long long *k1,
+                                             unsigned long long *k2)
+{
+    unsigned long long *r = fib_alloc();
+    if (r == NULL)
+        return NULL;
+    fib_mul(r, k1, k2);
+    return r;
+}
+
+static inline unsigned long long *fast_fib_req(unsigned int k,
+                                               struct fib_req *req)
+{
+    unsigned long long *r = fib_alloc();
+    if (r == NULL)
+        return NULL;
+
+    /* Walk k from its top bit keeping f(n-1), f(n), f(n+1), starting at
+     * n = 0. Only additions are needed, so the result stays exact modulo
+     * 2^128 instead of tripping over a wrapped subtraction.
+     *
+     * f(2n-1) = [f(n)]^2 + [f(n-1)]^2
+     * f(2n)   = f(n) * (f(n+1) + f(n-1))
+     * f(2n+1) = [f(n+1)]^2 + [f(n)]^2
+     */
+    unsigned long long a[2] = {1, 0}, b[2] = {0, 0}, c[2] = {1, 0};
+    if (k) {
+        for (unsigned int mask = 1U << (31 - __builtin_clz(k)); mask;
+             mask >>= 1) {
+            unsigned long long aa[2], bb[2], cc[2];
+            if (fib_preempt(req)) {
+                fib_free(r);
+                return NULL;
+            }
+            fib_sqr(aa, a);
+            fib_sqr(bb, b);
+            fib_sqr(cc, c);
+            fib_add(c, c, a);
+            fib_mul(b, b, c);
+            fib_add(a, aa, bb);
+            fib_add(c, cc, bb);
+            if (k & mask) {
+                a[0] = b[0];
+                a[1] = b[1];
+                b[0] = c[0];
+                b[1] = c[1];
+                fib_add(c, a, b);
+            }
+        }
+    }
+    r[0] = b[0];
+    r[1] = b[1];
+    return r;
+}
+
+static inline unsigned long long *fast_fib(unsigned int k)
+{
+    return fast_fib_req(k, NULL);
+}
+
+/* Move p = {f(i), f(i+1)} forward by n, to {f(i+n), f(i+n+1)}.
+ * Returns nonzero, leaving p somewhere in between, if preempted.
+ */
+static inline int fib_sequence_advance(unsigned long long p[2][2],
+                                       unsigned int n,
+                                       struct fib_req *req)
+{
+    for (unsigned int i = 1; i <= n; i++) {
+        unsigned long long t[2];
+        if (!(i % FIB_PREEMPT_STEPS) && fib_preempt(req))
+            return -1;
+        fib_add(t, p[0], p[1]);
+        p[0][0] = p[1][0];
+        p[0][1] = p[1][1];
+        p[1][0] = t[0];
+        p[1][1] = t[1];
+    }
+    return 0;
+}
+
+static inline unsigned long long *fib_sequence_req(unsigned int k,
+                                                   struct fib_req *req)
+{
+    unsigned long long p[2][2] = {{0, 0}, {1, 0}};
+    if (fib_sequence_advance(p, k, req))
+        return NULL;
+
+    unsigned long long *r = fib_alloc();
+    if (r == NULL)
+        return NULL;
+    r[0] = p[0][0];
+    r[1] = p[0][1];
+    return r;
+}
+
+static inline unsigned long long *fib_sequence(unsigned int k)
+{
+    return fib_sequence_req(k, NULL);
+}
+
+#endif /* FIB_ARITH_H */
@@ -1,13 +1,44 @@
+#include <linux/capability.h>
 #include <linux/cdev.h>
 #include <linux/device.h>
 #include <linux/fs.h>
 #include <linux/init.h>
+#include <linux/jiffies.h>
 #include <linux/kdev_t.h>
 #include <linux/kernel.h>
 #include <linux/limits.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/sched/signal.h>
 #include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+
+#include "fibdrv.h"
+
+/* Budget of a single read, checked from the loops in fib_arith.h */
+struct fib_req {
+    bool timed;             /* false for no time budget */
+    unsigned long deadline; /* in jiffies, only used when timed */
+    int err;
+};
+
+/* req is NULL for fast_fib() and fib_sequence(), which have no budget */
+static int fib_req_preempt(struct fib_req *req)
+{
+    cond_resched();
+    if (req == NULL)
+        return fatal_signal_pending(current) ? -EINTR : 0;
+    if (fatal_signal_pending(current))
+        req->err = -EINTR;
+    else if (req->timed && time_after(jiffies, req->deadline))
+        req->err = -ETIMEDOUT;
+    return req->err;
+}
+
+#define fib_preempt(req) fib_req_preempt(req)
+#include "fib_arith.h"
 
 
 MODULE_LICENSE("Dual MIT/GPL");
@@ -17,216 +48,294 @@ MODULE_VERSION("0.1");
 
 #define DEV_FIBONACCI_NAME "fibonacci"
 
-/* MAX_LENGTH is set to 92 because
- * ssize_t can't fit the number > 92
- */
-#define MAX_LENGTH 100
+static unsigned int max_offset = FIB_DEFAULT_MAX_OFFSET;
+module_param(max_offset, uint, 0644);
+MODULE_PARM_DESC(max_offset, "Largest offset a reader may seek to");
+
+static unsigned int max_time_ms = FIB_DEFAULT_MAX_TIME_MS;
+module_param(max_time_ms, uint, 0644);
+MODULE_PARM_DESC(max_time_ms, "Time budget of one read in ms, 0 for none");
 
 static dev_t fib_dev = 0;
 static struct cdev *fib_cdev;
 static struct class *fib_class;
 static DEFINE_MUTEX(fib_mutex);
 
-static unsigned long long *subtractor(unsigned long long *k1,
-                                      unsigned long long *k2)
+/* Checkpoints of the regular algorithm, see fibdrv.h. Entry i holds
+ * f(n), f(n + 1) for n = (i + 1) * FIB_CHECKPOINT_STEP.
+ */
+#define FIB_CHECKPOINTS 4096
+static struct fib_checkpoint fib_checkpoints[FIB_CHECKPOINTS];
+static unsigned int fib_checkpoint_count;
+static DEFINE_MUTEX(fib_checkpoint_mutex);
+
+static int fib_open(struct inode *inode, struct file *file)
 {
-    /* Assume k1 >= k2, return positive, or NULL as fail */
-    if (k1 == NULL || k2 == NULL)
-        return NULL;
-    if (k1[1] < k2[1])
-        return NULL;
-    if ((k1[1] == k2[1]) && (k1[0] < k2[0]))
-        return NULL;
-    unsigned long long *r = kmalloc(2 * sizeof(unsigned long long), GFP_KERNEL);
-    if (r == NULL) {
-        printk("kmalloc error");
-        return NULL;
+    if (!mutex_trylock(&fib_mutex)) {
+        printk(KERN_ALERT "fibdrv is in use");
+        return -EBUSY;
     }
-    if (k1[0] < k2[0]) {
-        /* Borrow */
-        k1[1] -= 1;
-        r[0] = ULONG_MAX + 1 - k2[0] + k1[0];
-        r[1] = k1[1] - k2[1];
-        return r;
-    } else {
-        r[1] = k1[1] - k2[1];
-        r[0] = k1[0] - k2[0];
-        return r;
+
+    struct fib_limits *limits = kmalloc(sizeof(*limits), GFP_KERNEL);
+    if (limits == NULL) {
+        mutex_unlock(&fib_mutex);
+        return -ENOMEM;
     }
+    limits->max_offset = READ_ONCE(max_offset);
+    limits->max_time_ms = READ_ONCE(max_time_ms);
+    file->private_data = limits;
+    return 0;
 }
 
-static unsigned long long *adder(unsigned long long *k1, unsigned long long *k2)
+static int fib_release(struct inode *inode, struct file *file)
 {
-    unsigned long long *r = kmalloc(2 * sizeof(unsigned long long), GFP_KERNEL);
-    if (r == NULL) {
-        printk("kmalloc error");
-        return NULL;
-    }
-    char carry = 0;
-    if ((ULONG_MAX - k2[0]) < k1[0])
-        carry = 1;
-    r[0] = k1[0] + k2[0];
-    r[1] = k1[1] + k2[1] + (unsigned long long) (carry);
-    return r;
+    kfree(file->private_data);
+    mutex_unlock(&fib_mutex);
+    return 0;
 }
 
-static unsigned long long *multiplier(unsigned long long *k1,
-                                      unsigned long long *k2)
+/* fib_sequence_req() resuming from, and filling in, the checkpoint table */
+static unsigned long long *fib_sequence_cached(unsigned int k,
+                                               struct fib_req *req)
 {
-    unsigned long long *r = kmalloc(2 * sizeof(unsigned long long), GFP_KERNEL);
-    if (r == NULL) {
-        printk("kmalloc error");
-        return NULL;
-    }
-    r[0] = 0;
-    r[1] = 0;
-    size_t width = 8 * sizeof(unsigned long long);
-    for (size_t i = 0; i < width; i++) {
-        if ((k2[0] >> i) & 0x1) {
-            r[1] += k1[1] << i;
-            unsigned long long t = k1[0];
-            (i == 0) ? (t = 0) : (t = t >> (width - i));
-            r[1] += t;
-            unsigned long long tmp[2] = {0};
-            tmp[1] = 0;
-            tmp[0] = k1[0] << i;
-            r = adder(r, tmp);
-            // r[0] += k1[0] << i;
-        }
-    }
-    for (size_t i = 0; i < width; i++) {
-        if ((k2[1] >> i) & 0x1) {
-            r[1] += k1[0] << i;
+    unsigned long long p[2][2] = {{0, 0}, {1, 0}};
+    unsigned int n = k / FIB_CHECKPOINT_STEP;
+
+    mutex_lock(&fib_checkpoint_mutex);
+    if (n > fib_checkpoint_count)
+        n = fib_checkpoint_count;
+    if (n)
+        memcpy(p, fib_checkpoints[n - 1].f, sizeof(p));
+    mutex_unlock(&fib_checkpoint_mutex);
+
+    for (unsigned int i = n * FIB_CHECKPOINT_STEP; i < k;) {
+        unsigned int step = min(k - i, FIB_CHECKPOINT_STEP);
+        if (fib_sequence_advance(p, step, req))
+            return NULL;
+        i += step;
+        if (step < FIB_CHECKPOINT_STEP)
+            break;
+
+        n = i / FIB_CHECKPOINT_STEP;
+        mutex_lock(&fib_checkpoint_mutex);
+        if (n == fib_checkpoint_count + 1 && n <= FIB_CHECKPOINTS) {
+            memcpy(fib_checkpoints[n - 1].f, p, sizeof(p));
+            fib_checkpoint_count = n;
         }
+        mutex_unlock(&fib_checkpoint_mutex);
     }
+
+    unsigned long long *r = fib_alloc();
+    if (r == NULL)
+        return NULL;
+    r[0] = p[0][0];
+    r[1] = p[0][1];
     return r;
 }
 
-static unsigned long long *fast_fib(int k)
+/* calculate the fibonacci number at given offset */
+static ssize_t fib_read(struct file *file,
+                        char *buf,
+                        size_t size,
+                        loff_t *offset)
 {
-    if (k == 0) {
-        unsigned long long *r =
-            kmalloc(2 * sizeof(unsigned long long), GFP_KERNEL);
-        if (r == NULL) {
-            printk("kmalloc error");
-            return NULL;
-        }
-        r[0] = 0;
-        r[1] = 0;
-        return r;
-    }
-    if (k == 1) {
-        unsigned long long *r =
-            kmalloc(2 * sizeof(unsigned long long), GFP_KERNEL);
-        if (r == NULL) {
-            printk("kmalloc error");
-            return NULL;
-        }
-        r[0] = 1;
-        r[1] = 0;
-        return r;
-    }
-    if (k == 2) {
-        unsigned long long *r =
-            kmalloc(2 * sizeof(unsigned long long), GFP_KERNEL);
-        if (r == NULL) {
-            printk("kmalloc error");
-            return NULL;
-        }
-        r[0] = 1;
-        r[1] = 0;
-        return r;
-    }
-    /* f(2n) = 2 * f(n+1) * f(n) - [f(n)]^2 */
-    /* f(2n+1) = [f(n+1)]^2 + [f(n)]^2 */
-    if (k % 2) {
-        /* Odd */
-        unsigned long long *fn1, *fn;
-        fn1 = fast_fib((k >> 1) + 1);
-        fn = fast_fib(k >> 1);
-        return adder(multiplier(fn1, fn1), multiplier(fn, fn));
+    struct fib_limits *limits = file->private_data;
+    /* pread() skips lseek, so the offset limit has to be checked here too */
+    if (*offset < 0 || *offset > limits->max_offset)
+        return -EINVAL;
+
+    struct fib_req req = {
+        .timed = limits->max_time_ms != 0,
+        .deadline = jiffies + msecs_to_jiffies(limits->max_time_ms),
+        .err = 0,
+    };
+    unsigned long long *f;
+    if (!memcmp(buf, "fast", 4)) {
+        f = fast_fib_req(*offset, &req);
     } else {
-        unsigned long long *fn1, *fn, *front;
-        unsigned long long two[2] = {0};
-        two[0] = 2;
-        fn1 = fast_fib((k >> 1) + 1);
-        fn = fast_fib(k >> 1);
-        front = multiplier(fn1, fn);
-        front = multiplier(two, front);
-        return subtractor(front, multiplier(fn, fn));
+        f = fib_sequence_cached(*offset, &req);
     }
+    if (f == NULL)
+        return req.err ? req.err : -ENOMEM;
+
+    fib_pack_result(buf, f);
+    ssize_t ret = f[0];
+    kfree(f);
+    return ret;
 }
 
-static unsigned long long *fib_sequence(int k)
+/* write operation is skipped */
+static ssize_t fib_write(struct file *file,
+                         const char *buf,
+                         size_t size,
+                         loff_t *offset)
 {
-    /* FIXME: use clz/ctz and fast algorithms to speed up */
-    unsigned long long *f[k + 2];
-    f[0] = kmalloc(2 * sizeof(unsigned long long), GFP_KERNEL);
-    f[1] = kmalloc(2 * sizeof(unsigned long long), GFP_KERNEL);
-    if (f[0] == NULL || f[1] == NULL) {
-        printk("kmalloc error");
-        return NULL;
-    }
-    f[0][1] = 0;
-    f[1][1] = 0;
-    f[0][0] = 0;
-    f[1][0] = 1;
+    return 1;
+}
 
-    for (int i = 2; i <= k; i++) {
-        f[i] = adder(f[i - 1], f[i - 2]);
-    }
-    return f[k];
+/* Exceeding the module wide limits needs CAP_SYS_ADMIN */
+static bool fib_limits_allowed(const struct fib_limits *limits)
+{
+    unsigned int time_ms = READ_ONCE(max_time_ms);
+    if (capable(CAP_SYS_ADMIN))
+        return true;
+    if (limits->max_offset > READ_ONCE(max_offset))
+        return false;
+    return !time_ms || (limits->max_time_ms && limits->max_time_ms <= time_ms);
 }
 
-static int fib_open(struct inode *inode, struct file *file)
+/* FNV-1a over the checkpoints, catches a truncated or corrupted file */
+static __u64 fib_snapshot_checksum(const struct fib_checkpoint *cp,
+                                   unsigned int count)
 {
-    if (!mutex_trylock(&fib_mutex)) {
-        printk(KERN_ALERT "fibdrv is in use");
-        return -EBUSY;
+    const unsigned char *p = (const unsigned char *) cp;
+    __u64 hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < count * sizeof(*cp); i++) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ULL;
     }
-    return 0;
+    return hash;
 }
 
-static int fib_release(struct inode *inode, struct file *file)
+static long fib_snapshot_save(struct fib_snapshot_io __user *uio)
 {
-    mutex_unlock(&fib_mutex);
-    return 0;
+    struct fib_snapshot_io io;
+    struct fib_snapshot_header header = {
+        .magic = FIB_SNAPSHOT_MAGIC,
+        .version = FIB_SNAPSHOT_VERSION,
+        .step = FIB_CHECKPOINT_STEP,
+    };
+    void __user *buf;
+    long rc = 0;
+
+    if (copy_from_user(&io, uio, sizeof(io)))
+        return -EFAULT;
+    buf = (void __user *) (uintptr_t) io.addr;
+
+    mutex_lock(&fib_checkpoint_mutex);
+    header.count = fib_checkpoint_count;
+    header.checksum = fib_snapshot_checksum(fib_checkpoints, header.count);
+    io.len = sizeof(header) + header.count * sizeof(struct fib_checkpoint);
+    if (io.size < io.len)
+        rc = -ENOSPC;
+    else if (copy_to_user(buf, &header, sizeof(header)) ||
+             copy_to_user(buf + sizeof(header), fib_checkpoints,
+                          io.len - sizeof(header)))
+        rc = -EFAULT;
+    mutex_unlock(&fib_checkpoint_mutex);
+
+    /* Report the length even on -ENOSPC so the caller can size its buffer */
+    if (put_user(io.len, &uio->len))
+        return -EFAULT;
+    return rc;
 }
 
-/* calculate the fibonacci number at given offset */
-static ssize_t fib_read(struct file *file,
-                        char *buf,
-                        size_t size,
-                        loff_t *offset)
+static long fib_snapshot_load(struct fib_snapshot_io __user *uio)
 {
-    unsigned long long *f;
-    if (!memcmp(buf, "fast", 4)) {
-        f = fast_fib(*offset);
-    } else {
-        f = fib_sequence(*offset);
+    struct fib_snapshot_io io;
+    struct fib_snapshot_header header;
+    struct fib_checkpoint *cp;
+    void __user *buf;
+    long rc = 0;
+
+    if (copy_from_user(&io, uio, sizeof(io)))
+        return -EFAULT;
+    buf = (void __user *) (uintptr_t) io.addr;
+    if (io.size < sizeof(header))
+        return -EINVAL;
+    if (copy_from_user(&header, buf, sizeof(header)))
+        return -EFAULT;
+    if (header.magic != FIB_SNAPSHOT_MAGIC ||
+        header.version != FIB_SNAPSHOT_VERSION ||
+        header.step != FIB_CHECKPOINT_STEP ||
+        header.count > FIB_CHECKPOINTS ||
+        io.size < sizeof(header) + header.count * sizeof(*cp))
+        return -EINVAL;
+    /* The table only grows, so a snapshot this small has nothing to add */
+    if (header.count == 0)
+        return -EEXIST;
+
+    cp = vmalloc(header.count * sizeof(*cp));
+    if (cp == NULL)
+        return -ENOMEM;
+    if (copy_from_user(cp, buf + sizeof(header),
+                       header.count * sizeof(*cp))) {
+        rc = -EFAULT;
+        goto out;
     }
 
-    memset(buf, 0, 16);
-    for (size_t i = 0; i < 8; i++) {
-        buf[i] = (f[0] >> (4 * i)) & 0xFF;
+    if (fib_snapshot_checksum(cp, header.count) != header.checksum) {
+        printk(KERN_ALERT "fibdrv: snapshot checksum mismatch");
+        rc = -EINVAL;
+        goto out;
     }
-    for (size_t i = 8; i < 16; i++) {
-        buf[i] = (f[1] >> (4 * (i - 8))) & 0xFF;
+
+    /* Never trust a snapshot, recompute every checkpoint the fast way.
+     * That is a few dozen doubling steps each, far below the cold fill
+     * of the table it saves.
+     */
+    for (unsigned int i = 0; i < header.count; i++) {
+        unsigned int n = (i + 1) * FIB_CHECKPOINT_STEP;
+        struct fib_req req = {.timed = false, .err = 0};
+        unsigned long long *f = fast_fib_req(n, &req);
+        unsigned long long *g = fast_fib_req(n + 1, &req);
+        if (f == NULL || g == NULL) {
+            rc = req.err ? req.err : -ENOMEM;
+        } else if (f[0] != cp[i].f[0][0] || f[1] != cp[i].f[0][1] ||
+                   g[0] != cp[i].f[1][0] || g[1] != cp[i].f[1][1]) {
+            printk(KERN_ALERT "fibdrv: bad checkpoint for f(%u)", n);
+            rc = -EINVAL;
+        }
+        kfree(f);
+        kfree(g);
+        if (rc)
+            goto out;
     }
-    return f[0];
+
+    mutex_lock(&fib_checkpoint_mutex);
+    if (header.count > fib_checkpoint_count) {
+        memcpy(fib_checkpoints, cp, header.count * sizeof(*cp));
+        fib_checkpoint_count = header.count;
+    } else {
+        rc = -EEXIST;
+    }
+    mutex_unlock(&fib_checkpoint_mutex);
+out:
+    vfree(cp);
+    return rc;
 }
 
-/* write operation is skipped */
-static ssize_t fib_write(struct file *file,
-                         const char *buf,
-                         size_t size,
-                         loff_t *offset)
+static long fib_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
-    return 1;
+    struct fib_limits *limits = file->private_data;
+    struct fib_limits new_limits;
+
+    switch (cmd) {
+    case FIB_IOC_GET_LIMITS:
+        if (copy_to_user((void __user *) arg, limits, sizeof(*limits)))
+            return -EFAULT;
+        return 0;
+    case FIB_IOC_SET_LIMITS:
+        if (copy_from_user(&new_limits, (void __user *) arg,
+                           sizeof(new_limits)))
+            return -EFAULT;
+        if (!fib_limits_allowed(&new_limits))
+            return -EPERM;
+        *limits = new_limits;
+        if (file->f_pos > limits->max_offset)
+            file->f_pos = limits->max_offset;
+        return 0;
+    case FIB_IOC_SNAPSHOT_SAVE:
+        return fib_snapshot_save((struct fib_snapshot_io __user *) arg);
+    case FIB_IOC_SNAPSHOT_LOAD:
+        return fib_snapshot_load((struct fib_snapshot_io __user *) arg);
+    }
+    return -ENOTTY;
 }
 
 static loff_t fib_device_lseek(struct file *file, loff_t offset, int orig)
 {
+    struct fib_limits *limits = file->private_data;
     loff_t new_pos = 0;
     switch (orig) {
     case 0: /* SEEK_SET: */
@@ -236,12 +345,12 @@ static loff_t fib_device_lseek(struct file *file, loff_t offset, int orig)
         new_pos = file->f_pos + offset;
         break;
     case 2: /* SEEK_END: */
-        new_pos = MAX_LENGTH - offset;
+        new_pos = limits->max_offset - offset;
         break;
     }
 
-    if (new_pos > MAX_LENGTH)
-        new_pos = MAX_LENGTH;  // max case
+    if (new_pos > limits->max_offset)
+        new_pos = limits->max_offset;  // max case
     if (new_pos < 0)
         new_pos = 0;        // min case
     file->f_pos = new_pos;  // This is what we'll use now
@@ -255,6 +364,7 @@ const struct file_operations fib_fops = {
     .open = fib_open,
     .release = fib_release,
     .llseek = fib_device_lseek,
+    .unlocked_ioctl = fib_ioctl,
 };
 
 static int __init init_fib_dev(void)
@@ -0,0 +1,78 @@
+#ifndef FIBDRV_H
+#define FIBDRV_H
+
+/* Interface of /dev/fibonacci shared by fibdrv.c and its clients */
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/* Limits of the reads made through one open file. They start out as the
+ * max_offset and max_time_ms module parameters; lowering them is always
+ * allowed, going beyond the module wide values needs CAP_SYS_ADMIN.
+ */
+struct fib_limits {
+    unsigned int max_offset;  /* largest offset lseek accepts */
+    unsigned int max_time_ms; /* time budget of one read, 0 for none */
+};
+
+/* Defaults of those parameters, shared with the userspace engine */
+#define FIB_DEFAULT_MAX_OFFSET 100
+#define FIB_DEFAULT_MAX_TIME_MS 1000
+
+/* read() leaves f(k) in the first FIB_RESULT_SIZE bytes of the caller's
+ * buffer, the low limb then the high one, each little-endian, and returns
+ * its low limb. The userspace engine in fibuser.c hands out results in the
+ * same layout.
+ */
+#define FIB_RESULT_SIZE 16
+
+static inline void fib_pack_result(char *buf, const unsigned long long *f)
+{
+    for (int i = 0; i < 8; i++) {
+        buf[i] = (f[0] >> (8 * i)) & 0xFF;
+        buf[i + 8] = (f[1] >> (8 * i)) & 0xFF;
+    }
+}
+
+#define FIB_IOC_MAGIC 'f'
+
+/* The module keeps f(n) and f(n + 1) for every n that is a multiple of
+ * FIB_CHECKPOINT_STEP reached by a regular read, so later reads resume from
+ * the nearest one. FIB_IOC_SNAPSHOT_SAVE serialises that table and
+ * FIB_IOC_SNAPSHOT_LOAD feeds it back, e.g. after the module is reloaded.
+ *
+ * A snapshot is a header followed by count checkpoints, in native byte
+ * order; checkpoint i is for n = (i + 1) * step. checksum is the 64-bit
+ * FNV-1a hash of the checkpoints, a cheap first check before the module
+ * recomputes every checkpoint and rejects the snapshot on any mismatch.
+ * Loading fails with EEXIST, installing nothing, unless the snapshot has
+ * more checkpoints than the module already holds.
+ */
+#define FIB_CHECKPOINT_STEP (1U << 16)
+#define FIB_SNAPSHOT_MAGIC 0x53424946 /* "FIBS" */
+#define FIB_SNAPSHOT_VERSION 1
+
+struct fib_snapshot_header {
+    __u32 magic;
+    __u32 version;
+    __u32 step;
+    __u32 count;
+    __u64 checksum;
+};
+
+struct fib_checkpoint {
+    __u64 f[2][2]; /* f(n) and f(n + 1), low limb first */
+};
+
+struct fib_snapshot_io {
+    __u64 addr; /* user buffer holding the snapshot */
+    __u32 size; /* size of that buffer */
+    __u32 len;  /* length of the snapshot, set by FIB_IOC_SNAPSHOT_SAVE */
+};
+
+#define FIB_IOC_GET_LIMITS _IOR(FIB_IOC_MAGIC, 1, struct fib_limits)
+#define FIB_IOC_SET_LIMITS _IOW(FIB_IOC_MAGIC, 2, struct fib_limits)
+#define FIB_IOC_SNAPSHOT_SAVE _IOWR(FIB_IOC_MAGIC, 3, struct fib_snapshot_io)
+#define FIB_IOC_SNAPSHOT_LOAD _IOW(FIB_IOC_MAGIC, 4, struct fib_snapshot_io)
+
+#endif /* FIBDRV_H */
@@ -0,0 +1,348 @@
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "fibuser.h"
+
+/* Budget of a single computation, checked from the loops in fib_arith.h */
+struct fib_req {
+    bool timed;                  /* false for no time budget */
+    unsigned long long deadline; /* CLOCK_MONOTONIC in ns, only when timed */
+    int err;
+};
+
+static unsigned long long now_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+static int fib_req_preempt(struct fib_req *req)
+{
+    if (req->timed && now_ns() > req->deadline)
+        req->err = -ETIMEDOUT;
+    return req->err;
+}
+
+#define fib_preempt(req) fib_req_preempt(req)
+#include "fib_arith.h"
+
+/* A range is cut into chunks of this many indices before it is queued */
+#define FIB_CHUNK 64
+#define FIB_QUEUE_SIZE 1024 /* power of two */
+#define FIB_CACHE_SIZE 4096 /* power of two */
+
+struct fib_job {
+    enum fib_algo algo;
+    unsigned int first;
+    unsigned long long (*out)[2];
+    atomic_uint remaining; /* chunks not yet done */
+    atomic_int err;
+    sem_t done; /* posted once by whoever finishes the last chunk */
+};
+
+struct fib_item {
+    struct fib_job *job;
+    unsigned int first, last;
+};
+
+/* Bounded MPMC queue after Dmitry Vyukov: a cell is free for the push at
+ * position pos when its seq equals pos, and holds an item for the pop at
+ * pos when seq equals pos + 1.
+ */
+struct fib_cell {
+    atomic_size_t seq;
+    struct fib_item item;
+};
+
+/* Direct mapped, each slot is a seqlock: odd seq while being written */
+struct fib_slot {
+    atomic_uint seq;
+    _Atomic unsigned long long key; /* 0 for empty */
+    _Atomic unsigned long long f[2];
+};
+
+struct fib_engine {
+    struct fib_limits limits;
+    struct fib_cell queue[FIB_QUEUE_SIZE];
+    atomic_size_t head, tail;
+    struct fib_slot cache[FIB_CACHE_SIZE];
+    atomic_ulong hits; /* for tests, see fib_engine_cache_hits() */
+    sem_t items; /* wakes workers, may run ahead of the queue */
+    atomic_bool stop;
+    unsigned int nthreads;
+    pthread_t threads[];
+};
+
+static int fib_queue_push(struct fib_engine *e, const struct fib_item *item)
+{
+    size_t pos = atomic_load_explicit(&e->tail, memory_order_relaxed);
+    struct fib_cell *cell;
+
+    for (;;) {
+        cell = &e->queue[pos & (FIB_QUEUE_SIZE - 1)];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(
+                    &e->tail, &pos, pos + 1, memory_order_relaxed,
+                    memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            return -1; /* full */
+        } else {
+            pos = atomic_load_explicit(&e->tail, memory_order_relaxed);
+        }
+    }
+    cell->item = *item;
+    atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+    return 0;
+}
+
+static int fib_queue_pop(struct fib_engine *e, struct fib_item *item)
+{
+    size_t pos = atomic_load_explicit(&e->head, memory_order_relaxed);
+    struct fib_cell *cell;
+
+    for (;;) {
+        cell = &e->queue[pos & (FIB_QUEUE_SIZE - 1)];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t) seq - (intptr_t) (pos + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(
+                    &e->head, &pos, pos + 1, memory_order_relaxed,
+                    memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            return -1; /* empty */
+        } else {
+            pos = atomic_load_explicit(&e->head, memory_order_relaxed);
+        }
+    }
+    *item = cell->item;
+    atomic_store_explicit(&cell->seq, pos + FIB_QUEUE_SIZE,
+                          memory_order_release);
+    return 0;
+}
+
+/* Results of the two algorithms are cached apart so timings stay honest */
+static unsigned long long fib_cache_key(unsigned int k, enum fib_algo algo)
+{
+    return ((unsigned long long) k << 1 | algo) + 1;
+}
+
+static int fib_cache_lookup(struct fib_engine *e,
+                            unsigned int k,
+                            enum fib_algo algo,
+                            unsigned long long *f)
+{
+    unsigned long long key = fib_cache_key(k, algo);
+    struct fib_slot *slot = &e->cache[key & (FIB_CACHE_SIZE - 1)];
+
+    unsigned int seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    if (seq & 1)
+        return 0;
+    /* Acquire keeps the data loads ahead of the second look at seq */
+    unsigned long long got =
+        atomic_load_explicit(&slot->key, memory_order_acquire);
+    f[0] = atomic_load_explicit(&slot->f[0], memory_order_acquire);
+    f[1] = atomic_load_explicit(&slot->f[1], memory_order_acquire);
+    return got == key &&
+           atomic_load_explicit(&slot->seq, memory_order_relaxed) == seq;
+}
+
+static void fib_cache_insert(struct fib_engine *e,
+                             unsigned int k,
+                             enum fib_algo algo,
+                             const unsigned long long *f)
+{
+    unsigned long long key = fib_cache_key(k, algo);
+    struct fib_slot *slot = &e->cache[key & (FIB_CACHE_SIZE - 1)];
+
+    /* Somebody else is writing this slot, just skip caching */
+    unsigned int seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+    if ((seq & 1) ||
+        !atomic_compare_exchange_strong_explicit(&slot->seq, &seq, seq + 1,
+                                                 memory_order_relaxed,
+                                                 memory_order_relaxed))
+        return;
+    /* A reader seeing any of these stores also sees the odd seq */
+    atomic_store_explicit(&slot->key, key, memory_order_release);
+    atomic_store_explicit(&slot->f[0], f[0], memory_order_release);
+    atomic_store_explicit(&slot->f[1], f[1], memory_order_release);
+    atomic_store_explicit(&slot->seq, seq + 2, memory_order_release);
+}
+
+static void fib_run(struct fib_engine *e, const struct fib_item *item)
+{
+    struct fib_job *job = item->job;
+
+    for (unsigned int k = item->first; k <= item->last; k++) {
+        unsigned long long *out = job->out[k - job->first];
+        if (atomic_load_explicit(&job->err, memory_order_relaxed))
+            break;
+        if (fib_cache_lookup(e, k, job->algo, out)) {
+            atomic_fetch_add_explicit(&e->hits, 1, memory_order_relaxed);
+            continue;
+        }
+
+        struct fib_req req = {
+            .timed = e->limits.max_time_ms != 0,
+            .deadline = now_ns() + e->limits.max_time_ms * 1000000ULL,
+            .err = 0,
+        };
+        unsigned long long *f = job->algo == FIB_ALGO_FAST
+                                    ? fast_fib_req(k, &req)
+                                    : fib_sequence_req(k, &req);
+        if (f == NULL) {
+            atomic_store(&job->err, req.err ? req.err : -ENOMEM);
+            break;
+        }
+        out[0] = f[0];
+        out[1] = f[1];
+        fib_free(f);
+        fib_cache_insert(e, k, job->algo, out);
+    }
+
+    if (atomic_fetch_sub(&job->remaining, 1) == 1)
+        sem_post(&job->done);
+}
+
+static void *fib_worker(void *arg)
+{
+    struct fib_engine *e = arg;
+    struct fib_item item;
+
+    for (;;) {
+        while (sem_wait(&e->items) && errno == EINTR)
+            ;
+        if (atomic_load(&e->stop))
+            break;
+        if (!fib_queue_pop(e, &item))
+            fib_run(e, &item);
+    }
+    return NULL;
+}
+
+struct fib_engine *fib_engine_create(unsigned int threads,
+                                     const struct fib_limits *limits)
+{
+    struct fib_engine *e =
+        calloc(1, sizeof(*e) + threads * sizeof(e->threads[0]));
+    if (e == NULL)
+        return NULL;
+
+    if (limits) {
+        e->limits = *limits;
+    } else {
+        e->limits.max_offset = FIB_DEFAULT_MAX_OFFSET;
+        e->limits.max_time_ms = FIB_DEFAULT_MAX_TIME_MS;
+    }
+    for (size_t i = 0; i < FIB_QUEUE_SIZE; i++)
+        atomic_init(&e->queue[i].seq, i);
+    sem_init(&e->items, 0, 0);
+
+    for (e->nthreads = 0; e->nthreads < threads; e->nthreads++) {
+        if (pthread_create(&e->threads[e->nthreads], NULL, fib_worker, e)) {
+            fib_engine_destroy(e);
+            return NULL;
+        }
+    }
+    return e;
+}
+
+void fib_engine_destroy(struct fib_engine *e)
+{
+    if (e == NULL)
+        return;
+    atomic_store(&e->stop, true);
+    for (unsigned int i = 0; i < e->nthreads; i++)
+        sem_post(&e->items);
+    for (unsigned int i = 0; i < e->nthreads; i++)
+        pthread_join(e->threads[i], NULL);
+    sem_destroy(&e->items);
+    free(e);
+}
+
+int fib_engine_range(struct fib_engine *e,
+                     unsigned int first,
+                     unsigned int last,
+                     enum fib_algo algo,
+                     unsigned long long (*out)[2])
+{
+    if (first > last)
+        return -EINVAL;
+
+    /* Indices past max_offset read f(max_offset), as lseek clamps them,
+     * so only [start, end] is computed and the rest copied from out[done].
+     */
+    unsigned int max = e->limits.max_offset;
+    unsigned int start = first < max ? first : max;
+    unsigned int end = last < max ? last : max;
+    unsigned int chunks = (end - start) / FIB_CHUNK + 1;
+
+    struct fib_job job = {
+        .algo = algo,
+        .first = start,
+        .out = out,
+    };
+    atomic_init(&job.remaining, chunks);
+    atomic_init(&job.err, 0);
+    sem_init(&job.done, 0, 0);
+
+    /* When the queue is full, and once everything is queued, the caller
+     * works on the queue too instead of just waiting.
+     */
+    struct fib_item item;
+    for (unsigned int i = 0; i < chunks; i++) {
+        struct fib_item chunk = {
+            .job = &job,
+            .first = start + i * FIB_CHUNK,
+            .last = i + 1 < chunks ? start + (i + 1) * FIB_CHUNK - 1 : end,
+        };
+        while (fib_queue_push(e, &chunk)) {
+            if (!fib_queue_pop(e, &item))
+                fib_run(e, &item);
+        }
+        sem_post(&e->items);
+    }
+    while (!fib_queue_pop(e, &item))
+        fib_run(e, &item);
+    while (sem_wait(&job.done) && errno == EINTR)
+        ;
+    sem_destroy(&job.done);
+
+    int rc = atomic_load(&job.err);
+    if (rc)
+        return rc;
+    unsigned int done = end - start;
+    for (unsigned int i = done + 1; i <= last - first; i++) {
+        out[i][0] = out[done][0];
+        out[i][1] = out[done][1];
+    }
+    return 0;
+}
+
+unsigned long fib_engine_cache_hits(struct fib_engine *e)
+{
+    return atomic_load_explicit(&e->hits, memory_order_relaxed);
+}
+
+long long fib_engine_read(struct fib_engine *e,
+                          unsigned int k,
+                          enum fib_algo algo,
+                          char *buf)
+{
+    unsigned long long f[2];
+    int rc = fib_engine_range(e, k, k, algo, &f);
+    if (rc)
+        return rc;
+    fib_pack_result(buf, f);
+    return f[0];
+}
@@ -0,0 +1,49 @@
+#ifndef FIBUSER_H
+#define FIBUSER_H
+
+/* Userspace fibonacci engine, for hosts that cannot load fibdrv.
+ *
+ * It is built from the same fib_arith.h and honours the same limits: an
+ * index beyond max_offset is clamped to it, as lseek on /dev/fibonacci
+ * does, and a computation running past max_time_ms fails with -ETIMEDOUT.
+ * Indices are spread over worker threads through a lock-free queue, and
+ * results are kept in a cache shared by all of them.
+ */
+
+#include "fibdrv.h"
+
+enum fib_algo {
+    FIB_ALGO_REGULAR,
+    FIB_ALGO_FAST,
+};
+
+struct fib_engine;
+
+/* threads may be 0, the caller then does all the work itself. limits may
+ * be NULL for the defaults of the module parameters.
+ */
+struct fib_engine *fib_engine_create(unsigned int threads,
+                                     const struct fib_limits *limits);
+void fib_engine_destroy(struct fib_engine *engine);
+
+/* f(k) for every k in [first, last], in out[k - first]. Several threads may
+ * call this at once. Returns 0 or a negative errno.
+ */
+int fib_engine_range(struct fib_engine *engine,
+                     unsigned int first,
+                     unsigned int last,
+                     enum fib_algo algo,
+                     unsigned long long (*out)[2]);
+
+/* Same as read() on /dev/fibonacci at offset k: fills buf with
+ * FIB_RESULT_SIZE bytes and returns the low limb, or a negative errno.
+ */
+long long fib_engine_read(struct fib_engine *engine,
+                          unsigned int k,
+                          enum fib_algo algo,
+                          char *buf);
+
+/* Indices served from the cache so far, only meant for tests */
+unsigned long fib_engine_cache_hits(struct fib_engine *engine);
+
+#endif /* FIBUSER_H */
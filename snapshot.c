@@ -0,0 +1,129 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "fibdrv.h"
+
+#define FIB_DEV "/dev/fibonacci"
+
+/* Save the checkpoint table of fibdrv to a file, or load one back into a
+ * freshly loaded module:
+ *
+ *     sudo ./snapshot save fib.snap
+ *     make unload load
+ *     sudo ./snapshot load fib.snap
+ */
+
+static int save(int fd, const char *path)
+{
+    struct fib_snapshot_io io = {0};
+    char *buf = NULL;
+
+    /* The first call only learns the length, even an empty table has a
+     * header. Retry while the table keeps growing in between.
+     */
+    while (ioctl(fd, FIB_IOC_SNAPSHOT_SAVE, &io) < 0) {
+        if (errno != ENOSPC) {
+            perror("Failed to save snapshot");
+            free(buf);
+            return 1;
+        }
+        free(buf);
+        buf = malloc(io.len);
+        if (buf == NULL) {
+            perror("malloc");
+            return 1;
+        }
+        io.addr = (uintptr_t) buf;
+        io.size = io.len;
+    }
+
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        perror(path);
+        free(buf);
+        return 1;
+    }
+    if (fwrite(buf, 1, io.len, f) != io.len) {
+        perror(path);
+        fclose(f);
+        free(buf);
+        return 1;
+    }
+    fclose(f);
+    free(buf);
+    printf("Saved %u bytes to %s\n", io.len, path);
+    return 0;
+}
+
+static int load(int fd, const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        return 1;
+    }
+    long size = -1;
+    if (!fseek(f, 0, SEEK_END))
+        size = ftell(f);
+    if (size < 0 || (unsigned long) size > UINT32_MAX) {
+        fprintf(stderr, "%s: not a regular file of at most 4 GiB\n", path);
+        fclose(f);
+        return 1;
+    }
+    rewind(f);
+
+    char *buf = malloc(size);
+    if (buf == NULL || fread(buf, 1, size, f) != (size_t) size) {
+        perror(path);
+        fclose(f);
+        free(buf);
+        return 1;
+    }
+    fclose(f);
+
+    struct fib_snapshot_io io = {
+        .addr = (uintptr_t) buf,
+        .size = size,
+    };
+    int rc = ioctl(fd, FIB_IOC_SNAPSHOT_LOAD, &io);
+    if (rc < 0 && errno == EEXIST) {
+        printf("Nothing loaded, the module already holds at least as many "
+               "checkpoints as %s\n",
+               path);
+        free(buf);
+        return 0;
+    }
+    if (rc < 0) {
+        perror("Failed to load snapshot");
+        free(buf);
+        return 1;
+    }
+    struct fib_snapshot_header *header = (struct fib_snapshot_header *) buf;
+    printf("Loaded %u checkpoints from %s\n", header->count, path);
+    free(buf);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 3 || (strcmp(argv[1], "save") && strcmp(argv[1], "load"))) {
+        fprintf(stderr, "usage: %s save|load FILE\n", argv[0]);
+        exit(1);
+    }
+
+    int fd = open(FIB_DEV, O_RDWR);
+    if (fd < 0) {
+        perror("Failed to open character device");
+        exit(1);
+    }
+
+    int rc = !strcmp(argv[1], "save") ? save(fd, argv[2]) : load(fd, argv[2]);
+    close(fd);
+    return rc;
+}
@@ -0,0 +1,112 @@
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../../fib_arith.h"
+#include "../../fibuser.h"
+
+#define MAX_INDEX 200000
+#define CALLERS 4
+#define CACHED 2047 /* FIB_CACHE_SIZE / 2 - 1 */
+
+static struct fib_engine *engine;
+static unsigned long long (*expect)[2];
+
+static void check_range(unsigned int first,
+                        unsigned int last,
+                        enum fib_algo algo)
+{
+    unsigned long long(*out)[2] = calloc(last - first + 1, sizeof(*out));
+    assert(out);
+    assert(fib_engine_range(engine, first, last, algo, out) == 0);
+    for (unsigned int k = first; k <= last; k++) {
+        unsigned int i = k > MAX_INDEX ? MAX_INDEX : k;
+        if (out[k - first][0] != expect[i][0] ||
+            out[k - first][1] != expect[i][1]) {
+            printf("f(%u) mismatch\n", k);
+            abort();
+        }
+    }
+    free(out);
+}
+
+/* Several callers share the queue and the cache at once */
+static void *caller(void *arg)
+{
+    unsigned int seed = (unsigned int) (size_t) arg;
+    for (int i = 0; i < 50; i++) {
+        unsigned int first = rand_r(&seed) % MAX_INDEX;
+        unsigned int last = first + rand_r(&seed) % 5000;
+        check_range(first, last, FIB_ALGO_FAST);
+        check_range(first, first + 10, FIB_ALGO_REGULAR);
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    expect = calloc(MAX_INDEX + 1, sizeof(*expect));
+    assert(expect);
+    for (unsigned int k = 0; k <= MAX_INDEX; k++) {
+        unsigned long long *f = fast_fib(k);
+        expect[k][0] = f[0];
+        expect[k][1] = f[1];
+        free(f);
+    }
+
+    struct fib_limits limits = {MAX_INDEX, 0};
+    engine = fib_engine_create(4, &limits);
+    assert(engine);
+
+    check_range(0, MAX_INDEX, FIB_ALGO_FAST);
+
+    /* Fast results for 0..CACHED each get their own slot of the direct
+     * mapped cache, so the second pass is served entirely from it.
+     */
+    check_range(0, CACHED, FIB_ALGO_FAST);
+    unsigned long hits = fib_engine_cache_hits(engine);
+    check_range(0, CACHED, FIB_ALGO_FAST);
+    assert(fib_engine_cache_hits(engine) - hits == CACHED + 1);
+    check_range(0, 5000, FIB_ALGO_REGULAR);
+    check_range(MAX_INDEX - 10, MAX_INDEX, FIB_ALGO_REGULAR);
+
+    /* Past max_offset everything reads f(max_offset), like lseek */
+    check_range(MAX_INDEX - 100, MAX_INDEX + 100, FIB_ALGO_FAST);
+    check_range(MAX_INDEX + 1, MAX_INDEX + 100, FIB_ALGO_FAST);
+
+    pthread_t t[CALLERS];
+    for (size_t i = 0; i < CALLERS; i++)
+        assert(!pthread_create(&t[i], NULL, caller, (void *) (i + 1)));
+    for (size_t i = 0; i < CALLERS; i++)
+        pthread_join(t[i], NULL);
+    printf("Ranges up to %d: passed\n", MAX_INDEX);
+
+    /* Same layout as read() on the device */
+    char buf[FIB_RESULT_SIZE];
+    assert(fib_engine_read(engine, 100, FIB_ALGO_FAST, buf) ==
+           (long long) expect[100][0]);
+    for (int i = 0; i < FIB_RESULT_SIZE; i++)
+        assert((unsigned char) buf[i] ==
+               ((expect[100][i / 8] >> (8 * (i % 8))) & 0xFF));
+    fib_engine_destroy(engine);
+
+    /* Without workers the caller does everything */
+    engine = fib_engine_create(0, &limits);
+    assert(engine);
+    check_range(0, 1000, FIB_ALGO_REGULAR);
+    fib_engine_destroy(engine);
+
+    /* The time budget applies as it does in the module */
+    limits = (struct fib_limits){~0U, 1};
+    engine = fib_engine_create(1, &limits);
+    assert(engine);
+    unsigned long long f[2];
+    assert(fib_engine_range(engine, ~0U, ~0U, FIB_ALGO_REGULAR, &f) ==
+           -ETIMEDOUT);
+    fib_engine_destroy(engine);
+    printf("Limits: passed\n");
+    free(expect);
+    return 0;
+}
@@ -0,0 +1,170 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../fib_arith.h"
+
+/* Cross-check the arithmetic kernels against the compiler's own 128-bit
+ * integers, which serve as the slow but obviously right reference.
+ *
+ * Built with -DLIBFUZZER this is a libFuzzer target. Otherwise main() runs
+ * every file given on the command line (AFL passes its input that way with
+ * @@), or stdin if the argument is "-", or a seeded random search biased
+ * towards limb boundaries when there is no argument at all.
+ */
+
+typedef unsigned __int128 u128;
+
+static u128 to_u128(const unsigned long long *a)
+{
+    return ((u128) a[1] << 64) | a[0];
+}
+
+static void expect(const char *op,
+                   const unsigned long long *a,
+                   const unsigned long long *b,
+                   const unsigned long long *r,
+                   u128 want)
+{
+    if (to_u128(r) == want)
+        return;
+    fprintf(stderr, "%s mismatch\n", op);
+    fprintf(stderr, "a: [%llu] [%llu]\n", a[1], a[0]);
+    fprintf(stderr, "b: [%llu] [%llu]\n", b[1], b[0]);
+    fprintf(stderr, "got: [%llu] [%llu]\n", r[1], r[0]);
+    fprintf(stderr, "want: [%llu] [%llu]\n",
+            (unsigned long long) (want >> 64), (unsigned long long) want);
+    abort();
+}
+
+static void check(const unsigned long long *a, const unsigned long long *b)
+{
+    u128 x = to_u128(a), y = to_u128(b);
+    unsigned long long r[2], k1[2], k2[2];
+
+    fib_add(r, a, b);
+    expect("fib_add", a, b, r, x + y);
+    fib_sub(r, a, b);
+    expect("fib_sub", a, b, r, x - y);
+    fib_mul(r, a, b);
+    expect("fib_mul", a, b, r, x * y);
+    fib_sqr(r, a);
+    expect("fib_sqr", a, a, r, x * x);
+    fib_mul64(r, a[0], b[0]);
+    expect("fib_mul64", a, b, r, (u128) a[0] * b[0]);
+
+    /* The result may alias either operand */
+    memcpy(r, a, sizeof(r));
+    fib_add(r, r, b);
+    expect("fib_add aliased", a, b, r, x + y);
+    memcpy(r, b, sizeof(r));
+    fib_sub(r, a, r);
+    expect("fib_sub aliased", a, b, r, x - y);
+    memcpy(r, b, sizeof(r));
+    fib_mul(r, a, r);
+    expect("fib_mul aliased", a, b, r, x * y);
+    memcpy(r, a, sizeof(r));
+    fib_sqr(r, r);
+    expect("fib_sqr aliased", a, a, r, x * x);
+
+    /* The allocating wrappers must leave their operands alone */
+    memcpy(k1, a, sizeof(k1));
+    memcpy(k2, b, sizeof(k2));
+    unsigned long long *s = adder(k1, k2);
+    expect("adder", a, b, s, x + y);
+    free(s);
+    s = multiplier(k1, k2);
+    expect("multiplier", a, b, s, x * y);
+    free(s);
+    s = subtractor(k1, k2);
+    if (x < y) {
+        if (s != NULL) {
+            fprintf(stderr, "subtractor should fail on a negative result\n");
+            abort();
+        }
+    } else {
+        expect("subtractor", a, b, s, x - y);
+    }
+    free(s);
+    expect("operand k1", a, b, k1, x);
+    expect("operand k2", a, b, k2, y);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    unsigned long long in[4] = {0};
+    memcpy(in, data, size < sizeof(in) ? size : sizeof(in));
+    check(&in[0], &in[2]);
+    check(&in[2], &in[0]);
+    return 0;
+}
+
+#ifndef LIBFUZZER
+#define RANDOM_CASES 1000000
+
+static unsigned long long random_limb(void)
+{
+    unsigned long long r = 0;
+    for (int i = 0; i < 4; i++)
+        r = (r << 16) | (rand() & 0xFFFF);
+
+    /* Carries and borrows live at the edges, go there often */
+    switch (rand() % 8) {
+    case 0:
+        return 0;
+    case 1:
+        return ~0ULL;
+    case 2:
+        return ~0ULL - (r & 0xFF);
+    case 3:
+        return r & 0xFF;
+    case 4:
+        return 1ULL << (r % 64);
+    case 5:
+        return r >> (r % 64);
+    default:
+        return r;
+    }
+}
+
+static int run_file(FILE *f)
+{
+    uint8_t data[64];
+    size_t size = fread(data, 1, sizeof(data), f);
+    return LLVMFuzzerTestOneInput(data, size);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) {
+            if (!strcmp(argv[i], "-")) {
+                run_file(stdin);
+                continue;
+            }
+            FILE *f = fopen(argv[i], "rb");
+            if (f == NULL) {
+                perror(argv[i]);
+                return 1;
+            }
+            run_file(f);
+            fclose(f);
+        }
+        return 0;
+    }
+
+    unsigned int seed = getenv("SEED") ? strtoul(getenv("SEED"), NULL, 0)
+                                       : 2019;
+    srand(seed);
+    printf("seed: %u\n", seed);
+    for (int i = 0; i < RANDOM_CASES; i++) {
+        unsigned long long in[4];
+        for (int j = 0; j < 4; j++)
+            in[j] = random_limb();
+        LLVMFuzzerTestOneInput((const uint8_t *) in, sizeof(in));
+    }
+    printf("%d random cases: passed\n", RANDOM_CASES);
+    return 0;
+}
+#endif
@@ -0,0 +1,135 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../../fib_arith.h"
+
+/* Indices go up to 10^6, past f(186) everything is checked modulo 2^128 */
+#define MAX_INDEX 1000000
+#define EXACT_INDEX 186
+#define RANDOM_CASES 2000
+
+static int equal(const unsigned long long *a, const unsigned long long *b)
+{
+    return a[0] == b[0] && a[1] == b[1];
+}
+
+static unsigned __int128 to_u128(const unsigned long long *a)
+{
+    return ((unsigned __int128) a[1] << 64) | a[0];
+}
+
+static unsigned __int128 gcd(unsigned __int128 a, unsigned __int128 b)
+{
+    while (b) {
+        unsigned __int128 t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static unsigned int gcd_index(unsigned int a, unsigned int b)
+{
+    while (b) {
+        unsigned int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/* f(n-1) * f(n+1) - [f(n)]^2 = (-1)^n */
+static void check_cassini(unsigned int n)
+{
+    unsigned long long *fp = fast_fib(n - 1);
+    unsigned long long *f = fast_fib(n);
+    unsigned long long *fn = fast_fib(n + 1);
+    unsigned long long one[2] = {1, 0};
+    unsigned long long lhs[2], rhs[2];
+    assert(fp && f && fn);
+
+    fib_mul(lhs, fp, fn);
+    fib_mul(rhs, f, f);
+    if (n % 2)
+        fib_add(lhs, lhs, one);
+    else
+        fib_add(rhs, rhs, one);
+    if (!equal(lhs, rhs)) {
+        printf("Cassini fails at n = %u\n", n);
+        abort();
+    }
+    free(fp);
+    free(f);
+    free(fn);
+}
+
+/* f(2n) = f(n) * L(n), L(n) = f(n-1) + f(n+1) */
+static void check_doubling(unsigned int n)
+{
+    unsigned long long *fp = fast_fib(n - 1);
+    unsigned long long *f = fast_fib(n);
+    unsigned long long *fn = fast_fib(n + 1);
+    unsigned long long *f2 = fast_fib(2 * n);
+    unsigned long long l[2];
+    assert(fp && f && fn && f2);
+
+    fib_add(l, fp, fn);
+    fib_mul(l, f, l);
+    if (!equal(l, f2)) {
+        printf("f(2n) = f(n)L(n) fails at n = %u\n", n);
+        abort();
+    }
+    free(fp);
+    free(f);
+    free(fn);
+    free(f2);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int seed = argc > 1 ? strtoul(argv[1], NULL, 0) : 2019;
+    srand(seed);
+    printf("seed: %u\n", seed);
+
+    /* Edge cases: limb boundaries, the 128-bit limit and powers of two */
+    unsigned int edges[] = {1,     2,     3,     46,     47,     92,
+                            93,    94,    185,   186,    187,    188,
+                            255,   256,   257,   65535,  65536,  65537,
+                            524287, 524288, 999999, MAX_INDEX};
+    for (size_t i = 0; i < sizeof(edges) / sizeof(edges[0]); i++) {
+        check_cassini(edges[i]);
+        if (edges[i] <= MAX_INDEX / 2)
+            check_doubling(edges[i]);
+    }
+    for (unsigned int n = 1; n <= 1000; n++) {
+        check_cassini(n);
+        check_doubling(n);
+    }
+    for (int i = 0; i < RANDOM_CASES; i++) {
+        unsigned int n = 1 + rand() % MAX_INDEX;
+        check_cassini(n);
+        if (n <= MAX_INDEX / 2)
+            check_doubling(n);
+    }
+    printf("Cassini, f(2n) = f(n)L(n): passed\n");
+
+    /* gcd(f(m), f(n)) = f(gcd(m, n)) only holds for exact values */
+    unsigned __int128 f[EXACT_INDEX + 1];
+    for (unsigned int n = 0; n <= EXACT_INDEX; n++) {
+        unsigned long long *r = fast_fib(n);
+        assert(r);
+        f[n] = to_u128(r);
+        free(r);
+    }
+    for (unsigned int m = 1; m <= EXACT_INDEX; m++) {
+        for (unsigned int n = 1; n <= EXACT_INDEX; n++) {
+            if (gcd(f[m], f[n]) != f[gcd_index(m, n)]) {
+                printf("gcd fails at m = %u, n = %u\n", m, n);
+                abort();
+            }
+        }
+    }
+    printf("gcd(f(m), f(n)) = f(gcd(m, n)): passed\n");
+    return 0;
+}
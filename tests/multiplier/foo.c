@@ -1,54 +1,7 @@
 #include <assert.h>
-#include <limits.h>
 #include <stdio.h>
-#include <stdlib.h>
 
-
-static unsigned long long *adder(unsigned long long *k1, unsigned long long *k2)
-{
-    unsigned long long *r = malloc(2 * sizeof(unsigned long long));
-    if (r == NULL) {
-        printf("kmalloc error");
-        return NULL;
-    }
-    char carry = 0;
-    if ((ULONG_MAX - k2[0]) < k1[0])
-        carry = 1;
-    r[0] = k1[0] + k2[0];
-    r[1] = k1[1] + k2[1] + (unsigned long long) (carry);
-    return r;
-}
-
-static unsigned long long *multiplier(unsigned long long *k1,
-                                      unsigned long long *k2)
-{
-    unsigned long long *r = malloc(2 * sizeof(unsigned long long));
-    if (r == NULL) {
-        printf("kmalloc error");
-        return NULL;
-    }
-    r[0] = 0;
-    r[1] = 0;
-    size_t width = 8 * sizeof(unsigned long long);
-    for (size_t i = 0; i < width; i++) {
-        if ((k2[0] >> i) & 0x1) {
-            r[1] += k1[1] << i;
-            unsigned long long t = k1[0];
-            (i == 0) ? (t = 0) : (t = t >> (width - i));
-            r[1] += t;
-            unsigned long long tmp[2] = {0};
-            tmp[1] = 0;
-            tmp[0] = k1[0] << i;
-            r = adder(r, tmp);
-        }
-    }
-    for (size_t i = 0; i < width; i++) {
-        if ((k2[1] >> i) & 0x1) {
-            r[1] += k1[0] << i;
-        }
-    }
-    return r;
-}
+#include "../../fib_arith.h"
 
 int main(int argc, char **argv)
 {
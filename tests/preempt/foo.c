@@ -0,0 +1,49 @@
+#include <assert.h>
+#include <stdio.h>
+
+/* Stand in for the module's budget: stop after a number of polls */
+struct fib_req {
+    int polls;
+    int limit;
+};
+
+static int stop_after(struct fib_req *req)
+{
+    if (req == NULL)
+        return 0;
+    return ++req->polls > req->limit;
+}
+
+#define fib_preempt(req) stop_after(req)
+#include "../../fib_arith.h"
+
+int main(int argc, char **argv)
+{
+    /* Enough budget, same result as without one */
+    struct fib_req req = {0, 1000};
+    unsigned long long *f = fib_sequence_req(100000, &req);
+    unsigned long long *g = fib_sequence(100000);
+    assert(f && g && f[0] == g[0] && f[1] == g[1]);
+    printf("Sequence polled %d times\n", req.polls);
+    assert(req.polls == 100000 / FIB_PREEMPT_STEPS);
+
+    req = (struct fib_req){0, 1000};
+    unsigned long long *h = fast_fib_req(100000, &req);
+    assert(h && h[0] == g[0] && h[1] == g[1]);
+    printf("Doubling polled %d times\n", req.polls);
+    assert(req.polls == 17);
+
+    /* Out of budget, the loops give up */
+    req = (struct fib_req){0, 3};
+    assert(fib_sequence_req(100000, &req) == NULL);
+    assert(req.polls == 4);
+    req = (struct fib_req){0, 3};
+    assert(fast_fib_req(100000, &req) == NULL);
+    assert(req.polls == 4);
+
+    /* Short requests never reach a preemption point in the sequence */
+    req = (struct fib_req){0, 0};
+    unsigned long long *s = fib_sequence_req(100, &req);
+    assert(s && req.polls == 0);
+    return 0;
+}
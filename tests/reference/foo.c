@@ -0,0 +1,22 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../../fib_arith.h"
+
+/* Read indices from stdin and print "k fast_hi fast_lo seq_hi seq_lo" for
+ * each of them, ref.py compares the output with Python's big integers.
+ */
+int main(int argc, char **argv)
+{
+    unsigned int k;
+    while (scanf("%u", &k) == 1) {
+        unsigned long long *f = fast_fib(k);
+        unsigned long long *s = fib_sequence(k);
+        if (f == NULL || s == NULL)
+            return 1;
+        printf("%u %llu %llu %llu %llu\n", k, f[1], f[0], s[1], s[0]);
+        free(f);
+        free(s);
+    }
+    return 0;
+}
@@ -0,0 +1,49 @@
+import random
+import subprocess
+import sys
+
+MAX_INDEX = 10**6
+RANDOM_CASES = 300
+MOD = 1 << 128
+
+
+def fib(n):
+    # fast doubling with Python's big integers, returns (f(n), f(n+1))
+    if n == 0:
+        return (0, 1)
+    a, b = fib(n >> 1)
+    c = a * (2 * b - a)
+    d = a * a + b * b
+    if n & 1:
+        return (d, c + d)
+    return (c, d)
+
+
+seed = int(sys.argv[1]) if len(sys.argv) > 1 else 2019
+rng = random.Random(seed)
+print('seed: %d' % seed)
+
+index = list(range(0, 300))
+for i in range(1, 20):
+    index += [(1 << i) - 1, 1 << i, (1 << i) + 1]
+index += [MAX_INDEX - 1, MAX_INDEX]
+index += [rng.randint(0, MAX_INDEX) for _ in range(RANDOM_CASES)]
+
+out = subprocess.run(['./foo'], input='\n'.join(map(str, index)),
+                     stdout=subprocess.PIPE, universal_newlines=True,
+                     check=True).stdout.split('\n')
+out = [l for l in out if l]
+if len(out) != len(index):
+    print('expect %d results, got %d' % (len(index), len(out)))
+    exit(1)
+
+for line in out:
+    k, fh, fl, sh, sl = map(int, line.split())
+    expect = fib(k)[0] % MOD
+    for name, h, l in (('fast', fh, fl), ('regular', sh, sl)):
+        if (h << 64 | l) != expect:
+            print('%s f(%d) fail' % (name, k))
+            print(h << 64 | l)
+            print(expect)
+            exit(1)
+print('%d indices up to %d: passed' % (len(index), MAX_INDEX))
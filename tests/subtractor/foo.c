@@ -1,35 +1,7 @@
-#include <limits.h>
-#include <stdio.h>
-#include <stdlib.h>
 #include <assert.h>
+#include <stdio.h>
 
-static unsigned long long *subtractor(unsigned long long *k1,
-                                      unsigned long long *k2)
-{
-    /* Assume k1 >= k2, return positive, or NULL as fail */
-    if (k1 == NULL || k2 == NULL)
-        return NULL;
-    if (k1[1] < k2[1])
-        return NULL;
-    if ((k1[1] == k2[1]) && (k1[0] < k2[0]))
-        return NULL;
-    unsigned long long *r = malloc(2 * sizeof(unsigned long long));
-    if (r == NULL) {
-        printf("kmalloc error");
-        return NULL;
-    }
-    if (k1[0] < k2[0]) {
-        /* Borrow */
-        k1[1] -= 1;
-        r[0] = ULONG_MAX + 1 - k2[0] + k1[0];
-        r[1] = k1[1] - k2[1];
-        return r;
-    } else {
-        r[1] = k1[1] - k2[1];
-        r[0] = k1[0] - k2[0];
-        return r;
-    }
-}
+#include "../../fib_arith.h"
 
 int main(int argc, char **argv)
 {